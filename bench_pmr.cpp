@@ -0,0 +1,144 @@
+// Benchmarks standard containers on the bogo heap against the standard memory resources.
+//
+//   gcc -O2 -c -DBOGOALLOC_NO_MAIN -DHEAPSIZE='(1 << 22)' -DCHUNK_NUM=65536 mal.c
+//   g++ -O2 -std=c++17 bench_pmr.cpp mal.o -o bench_pmr
+//
+// Add -DBOGO_HUGEPAGE to the mal.c build to compare against a heap backed by transparent huge pages.
+// On Linux the dTLB load misses of each benchmark are reported as well, if perf events are permitted.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "bogo_resource.hpp"
+
+static const int N = 2000;
+static const int ROUNDS = 20;
+
+// Counts dTLB load misses of this thread in user space. Returns -1 where perf events are unavailable.
+static int open_dtlb_counter() {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+    return -1;
+#endif
+}
+
+static const int dtlb = open_dtlb_counter();
+
+// Shows whether transparent huge pages actually back the heap, even where perf events are unavailable.
+static void print_huge_pages() {
+#ifdef __linux__
+    FILE *fp = fopen("/proc/self/smaps_rollup", "r");
+    if (!fp) return;
+    char line[256];
+    while (fgets(line, sizeof line, fp))
+        if (strncmp(line, "AnonHugePages:", 14) == 0)
+            printf("%s", line);
+    fclose(fp);
+#endif
+}
+
+template<typename F>
+static void bench(const char *name, F f) {
+#ifdef __linux__
+    if (0 <= dtlb) {
+        ioctl(dtlb, PERF_EVENT_IOC_RESET, 0);
+        ioctl(dtlb, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        f();
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-48s %10.1f ns/element", name, ns / ROUNDS / N);
+
+    uint64_t misses = 0;
+#ifdef __linux__
+    if (0 <= dtlb) {
+        ioctl(dtlb, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(dtlb, &misses, sizeof misses) == sizeof misses) {
+            printf(" %8.3f dTLB misses/element\n", static_cast<double>(misses) / ROUNDS / N);
+            return;
+        }
+    }
+#endif
+    printf("\n");
+}
+
+// With monotonic set, the containers allocate from a monotonic_buffer_resource on top of res.
+static void bench_resource(const char *name, std::pmr::memory_resource *res, bool monotonic) {
+    char label[64];
+
+    snprintf(label, sizeof label, "pmr::vector<int> %s", name);
+    bench(label, [&] {
+        std::pmr::monotonic_buffer_resource mono(res);
+        std::pmr::vector<int> v(monotonic ? &mono : res);
+        for (int i = 0; i < N; i++) v.push_back(i);
+    });
+
+    snprintf(label, sizeof label, "pmr::list<int> %s", name);
+    bench(label, [&] {
+        std::pmr::monotonic_buffer_resource mono(res);
+        std::pmr::list<int> l(monotonic ? &mono : res);
+        for (int i = 0; i < N; i++) l.push_back(i);
+    });
+
+    snprintf(label, sizeof label, "pmr::unordered_map<int, int> %s", name);
+    bench(label, [&] {
+        std::pmr::monotonic_buffer_resource mono(res);
+        std::pmr::unordered_map<int, int> m(monotonic ? &mono : res);
+        for (int i = 0; i < N; i++) m[i] = i;
+    });
+}
+
+int main() {
+    bench_resource("new_delete", std::pmr::new_delete_resource(), false);
+    bench_resource("monotonic", std::pmr::new_delete_resource(), true);
+    bench_resource("bogo", bogo_resource(), false);
+    bench_resource("monotonic on bogo", bogo_resource(), true);
+
+    bench("std::vector<int> std::allocator", [] {
+        std::vector<int> v;
+        for (int i = 0; i < N; i++) v.push_back(i);
+    });
+    bench("std::vector<int> BogoAllocator", [] {
+        std::vector<int, BogoAllocator<int>> v;
+        for (int i = 0; i < N; i++) v.push_back(i);
+    });
+    bench("std::unordered_map<int, int> std::allocator", [] {
+        std::unordered_map<int, int> m;
+        for (int i = 0; i < N; i++) m[i] = i;
+    });
+    bench("std::unordered_map<int, int> BogoAllocator", [] {
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+            BogoAllocator<std::pair<const int, int>>> m;
+        for (int i = 0; i < N; i++) m[i] = i;
+    });
+
+    print_huge_pages();
+#ifdef __linux__
+    if (0 <= dtlb) close(dtlb);
+#endif
+    return 0;
+}
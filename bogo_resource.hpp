@@ -0,0 +1,71 @@
+// C++ adapters for the bogo heap: a std::pmr::memory_resource and a typed STL allocator.
+#ifndef BOGO_RESOURCE_HPP
+#define BOGO_RESOURCE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+#include "bogoalloc.h"
+
+// There is only one bogo heap per process, so there is only one resource.
+// Obtain it with bogo_resource(), which also initializes the heap on first use.
+// The heap has no lock: like std::pmr::unsynchronized_pool_resource, the resource must only be
+// used from one thread at a time.
+class BogoResource : public std::pmr::memory_resource {
+public:
+    BogoResource(const BogoResource&) = delete;
+    BogoResource& operator=(const BogoResource&) = delete;
+
+private:
+    BogoResource() { init_bogoalloc(); }
+    friend BogoResource *bogo_resource();
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *p = bogoalloc_aligned(bytes, alignment);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+
+    void do_deallocate(void *p, std::size_t bytes, std::size_t) override {
+        bogofree_sized(p, bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+};
+
+inline BogoResource *bogo_resource() {
+    static BogoResource resource;
+    return &resource;
+}
+
+// Stateless allocator for containers that take an allocator type rather than a resource,
+// e.g. std::vector<int, BogoAllocator<int>>.
+template<typename T>
+struct BogoAllocator {
+    using value_type = T;
+
+    BogoAllocator() noexcept = default;
+    template<typename U>
+    BogoAllocator(const BogoAllocator<U>&) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if (std::numeric_limits<std::size_t>::max() / sizeof(T) < n)
+            throw std::bad_array_new_length();
+        return static_cast<T*>(bogo_resource()->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept {
+        bogo_resource()->deallocate(p, n * sizeof(T), alignof(T));
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const BogoAllocator<T>&, const BogoAllocator<U>&) noexcept { return true; }
+template<typename T, typename U>
+bool operator!=(const BogoAllocator<T>&, const BogoAllocator<U>&) noexcept { return false; }
+
+#endif
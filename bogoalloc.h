@@ -0,0 +1,50 @@
+// Public interface of the free list allocator in mal.c.
+// Build mal.c with -DBOGOALLOC_NO_MAIN to link it into another program.
+#ifndef BOGOALLOC_H
+#define BOGOALLOC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void init_bogoalloc();
+void *bogoalloc(size_t size);
+void *bogoalloc_aligned(size_t size, size_t alignment);
+void bogofree(void *p);
+void bogofree_sized(void *p, size_t size);
+
+// Available when mal.c is built with -DBOGO_STATS.
+#ifdef BOGO_STATS
+#define BOGO_STATS_BUCKETS 32
+
+// Histograms are bucketed by log2: bucket 0 holds zeros, bucket k holds [2^(k-1), 2^k).
+typedef struct OpStats {
+    size_t calls;
+    size_t search_total;
+    size_t merge_total;
+    size_t split_total;
+    uint64_t ticks_total;
+    size_t search_hist[BOGO_STATS_BUCKETS];
+    size_t merge_hist[BOGO_STATS_BUCKETS];
+    size_t split_hist[BOGO_STATS_BUCKETS];
+    size_t ticks_hist[BOGO_STATS_BUCKETS];
+} OpStats;
+
+typedef struct BogoStats {
+    OpStats alloc;
+    OpStats free;
+    size_t skipped_threads; // Threads that called in after the stats pool ran out
+} BogoStats;
+
+void bogo_stats_aggregate(BogoStats *out);
+void bogo_stats_print(const BogoStats *stats);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
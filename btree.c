@@ -22,6 +22,37 @@ static Node *alloc_chunks = NULL;
 static Node *unused_chunks = NULL;
 static size_t id_gen = 1;
 
+// Heads of allocated leaves, so bogofree can reject a pointer before walking the tree.
+static uint8_t live_map[(HEAPSIZE / ALIGNMENT + 7) / 8] = {0};
+
+static int live_index(const void *p, size_t *bit){
+    uintptr_t off = (uintptr_t)p - (uintptr_t)heap;
+    if(HEAPSIZE <= off || off % ALIGNMENT)
+        return 0;
+    *bit = off / ALIGNMENT;
+    return 1;
+}
+
+static int is_live(const void *p){
+    size_t bit;
+    return live_index(p, &bit) && (live_map[bit / 8] >> (bit % 8) & 1);
+}
+
+static void set_live(const void *p, int live){
+    size_t bit;
+    if(!live_index(p, &bit))
+        return;
+    if(live)
+        live_map[bit / 8] |= 1u << (bit % 8);
+    else
+        live_map[bit / 8] &= ~(1u << (bit % 8));
+}
+
+// Leaves keep their unrounded size, so round up to find where the next block may start.
+static unsigned char *node_end(const Node *node) {
+    return node->head + (node->sz + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
 static Node *find_best(Node **root, size_t size) {
     if (!root) return NULL;
     if (!*root) {
@@ -49,7 +80,7 @@ static Node *find_best(Node **root, size_t size) {
         if (right) return right;
     }
     if ((*root)->left && (*root)->right) {
-        size_t gap_size = (*root)->right->head - ((*root)->left->head + (*root)->left->sz);
+        size_t gap_size = (*root)->right->head - node_end((*root)->left);
         printf("Gap size: %lu at %p\n", gap_size, (*root)->head);
         if (size == gap_size) {
             // Fetch a node for parent node from free list
@@ -64,7 +95,7 @@ static Node *find_best(Node **root, size_t size) {
             new_node->left = NULL;
             new_node->right = NULL;
             new_node->id = id_gen++;
-            new_node->head = ((*root)->left->head + (*root)->left->sz);
+            new_node->head = node_end((*root)->left);
             new_node->sz = size;
 
             // Graft the tree
@@ -93,14 +124,14 @@ static Node *allocate_end(size_t size) {
 
     // Init parent node
     new_parent->head = alloc_chunks->head;
-    new_parent->sz = alloc_chunks->sz + size;
+    new_parent->sz = node_end(alloc_chunks) - alloc_chunks->head + size;
     new_parent->id = id_gen++;
     new_parent->left = alloc_chunks;
     new_parent->right = new_node;
     printf("%lu new_parent->head: %p, size: %lu\n", new_parent->id, new_parent->head, new_parent->sz);
 
     // Init leaf node
-    new_node->head = alloc_chunks->head + alloc_chunks->sz;
+    new_node->head = node_end(alloc_chunks);
     new_node->sz = size;
     new_node->id = id_gen++;
     new_node->left = NULL;
@@ -139,6 +170,7 @@ void *bogoalloc(size_t size){
     }
 
     node->sz = size;
+    set_live(node->head, 1);
 
     return node->head;
 }
@@ -193,6 +225,11 @@ static int free_recursive(void *p, Node **node) {
 }
 
 int bogofree(void *p){
+    if (!is_live(p)) {
+        fprintf(stderr, "Free unknown heap!\n");
+        return 0;
+    }
+    set_live(p, 0);
     return free_recursive(p, &alloc_chunks);
 }
 
@@ -243,6 +280,13 @@ int main(){
     init_bogoalloc();
     printf("Unused chunks: %lu\n", count_nodes(unused_chunks));
 
+    // A block placed after an odd sized one must still start aligned, or bogofree would reject it
+    void *odd = bogoalloc(9);
+    void *after_odd = bogoalloc(8);
+    printf("Free after odd size: %d\n", bogofree(after_odd));
+    printf("Free odd size: %d\n", bogofree(odd));
+    printf("Free odd size again: %d\n", bogofree(odd));
+
     double *ptrs[15] = {NULL};
 
     for(int i = 0; i < 10; i++){
@@ -23,6 +23,32 @@ static Node *free_list = NULL;
 
 static Node *find_node(void *p);
 
+// Payload starts of active nodes; see "Invalid and double free detection" in README.md.
+static uint8_t live_map[(HEAPSIZE / ALIGNMENT + 7) / 8] = {0};
+
+static int live_index(const void *p, size_t *bit){
+    uintptr_t off = (uintptr_t)p - (uintptr_t)heap;
+    if(HEAPSIZE <= off || off % ALIGNMENT)
+        return 0;
+    *bit = off / ALIGNMENT;
+    return 1;
+}
+
+static int is_live(const void *p){
+    size_t bit;
+    return live_index(p, &bit) && (live_map[bit / 8] >> (bit % 8) & 1);
+}
+
+static void set_live(const void *p, int live){
+    size_t bit;
+    if(!live_index(p, &bit))
+        return;
+    if(live)
+        live_map[bit / 8] |= 1u << (bit % 8);
+    else
+        live_map[bit / 8] &= ~(1u << (bit % 8));
+}
+
 void init_bogoalloc() {
     Node *root = (Node*)heap;
     root->sz = HEAPSIZE - sizeof(Node);
@@ -66,15 +92,19 @@ void *bogoalloc(size_t size) {
         if (free_list) free_list->prev = NULL;
     }
 
-    return (unsigned char*)new_node + sizeof(Node);
+    void *ret = (unsigned char*)new_node + sizeof(Node);
+    set_live(ret, 1);
+    return ret;
 }
 
 void bogofree(void *p) {
-    Node *node = find_node(p);
-    if (!node) {
+    if (!is_live(p)) {
         fprintf(stderr, "Free unknown heap!");
         return;
     }
+    // A live bit is only set at the start of a payload, so the node header sits right before it
+    Node *node = (Node*)((unsigned char*)p - sizeof(Node));
+    set_live(p, 0);
     if (node->next) node->next->prev = node->prev;
     if (node->prev) node->prev->next = node->next;
     if (active_list == node) active_list = node->next;
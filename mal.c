@@ -3,132 +3,550 @@
 #include <string.h>
 #include <stdint.h>
 
+#include "bogoalloc.h"
+
+// HEAPSIZE and CHUNK_NUM can be overridden on the command line, e.g. for benchmarks.
+#ifndef HEAPSIZE
 #define HEAPSIZE (1024 * 1)
+#endif
 #define ALIGNMENT 8
+#ifndef CHUNK_NUM
 #define CHUNK_NUM 1024
+#endif
+
+// Build with -DBOGO_STATS to collect per-thread hot path statistics.
+#ifdef BOGO_STATS
+#include <stdatomic.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+#define STATS_THREADS 64
+
+// Each thread claims a slot on its first call, so aggregation never touches freed memory.
+// Threads past STATS_THREADS get no slot and are not recorded; stats_used still counts them.
+static BogoStats stats_pool[STATS_THREADS];
+static atomic_size_t stats_used = 0;
+static _Thread_local BogoStats *thread_stats = NULL;
+static _Thread_local int thread_claimed = 0;
+
+static inline uint64_t stats_ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+static inline size_t stats_bucket(uint64_t v){
+    size_t b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < BOGO_STATS_BUCKETS ? b : BOGO_STATS_BUCKETS - 1;
+}
+
+static BogoStats *stats_local(){
+    if(!thread_claimed){
+        thread_claimed = 1;
+        size_t slot = atomic_fetch_add(&stats_used, 1);
+        if(slot < STATS_THREADS)
+            thread_stats = &stats_pool[slot];
+    }
+    return thread_stats;
+}
+
+// Each slot has a single writer, but bogo_stats_aggregate reads it from other threads.
+// Relaxed atomic loads and stores make that race free and still compile to plain moves.
+#define STATS_ADD(counter, v) __atomic_store_n(&(counter), __atomic_load_n(&(counter), __ATOMIC_RELAXED) + (v), __ATOMIC_RELAXED)
+#define STATS_LOAD(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+static void stats_record(OpStats *op, size_t search, size_t merges, size_t splits, uint64_t ticks){
+    STATS_ADD(op->calls, 1);
+    STATS_ADD(op->search_total, search);
+    STATS_ADD(op->merge_total, merges);
+    STATS_ADD(op->split_total, splits);
+    STATS_ADD(op->ticks_total, ticks);
+    STATS_ADD(op->search_hist[stats_bucket(search)], 1);
+    STATS_ADD(op->merge_hist[stats_bucket(merges)], 1);
+    STATS_ADD(op->split_hist[stats_bucket(splits)], 1);
+    STATS_ADD(op->ticks_hist[stats_bucket(ticks)], 1);
+}
+
+static void stats_add(OpStats *dst, const OpStats *src){
+    dst->calls += STATS_LOAD(src->calls);
+    dst->search_total += STATS_LOAD(src->search_total);
+    dst->merge_total += STATS_LOAD(src->merge_total);
+    dst->split_total += STATS_LOAD(src->split_total);
+    dst->ticks_total += STATS_LOAD(src->ticks_total);
+    for(size_t i = 0; i < BOGO_STATS_BUCKETS; i++){
+        dst->search_hist[i] += STATS_LOAD(src->search_hist[i]);
+        dst->merge_hist[i] += STATS_LOAD(src->merge_hist[i]);
+        dst->split_hist[i] += STATS_LOAD(src->split_hist[i]);
+        dst->ticks_hist[i] += STATS_LOAD(src->ticks_hist[i]);
+    }
+}
+
+// Sum the statistics of every thread that has called into the allocator so far.
+void bogo_stats_aggregate(BogoStats *out){
+    memset(out, 0, sizeof *out);
+    size_t used = atomic_load(&stats_used);
+    if(STATS_THREADS < used){
+        out->skipped_threads = used - STATS_THREADS;
+        used = STATS_THREADS;
+    }
+    for(size_t i = 0; i < used; i++){
+        stats_add(&out->alloc, &stats_pool[i].alloc);
+        stats_add(&out->free, &stats_pool[i].free);
+    }
+}
+
+static void print_hist(const char *name, const size_t *hist){
+    printf("  %-7s", name);
+    size_t last = 0;
+    for(size_t i = 0; i < BOGO_STATS_BUCKETS; i++)
+        if(hist[i]) last = i;
+    for(size_t i = 0; i <= last; i++)
+        printf(" %lu", hist[i]);
+    putchar('\n');
+}
+
+static void print_op_stats(const char *name, const OpStats *op){
+    printf("%s: calls %lu, search %lu, merges %lu, splits %lu, ticks %lu\n", name,
+        op->calls, op->search_total, op->merge_total, op->split_total, (size_t)op->ticks_total);
+    print_hist("search", op->search_hist);
+    print_hist("merges", op->merge_hist);
+    print_hist("splits", op->split_hist);
+    print_hist("ticks", op->ticks_hist);
+}
+
+void bogo_stats_print(const BogoStats *stats){
+    print_op_stats("bogoalloc", &stats->alloc);
+    print_op_stats("bogofree", &stats->free);
+    if(stats->skipped_threads)
+        printf("%lu threads past the first %d were not recorded\n", stats->skipped_threads, STATS_THREADS);
+}
+
+#define STATS_BEGIN() size_t stat_search = 0, stat_merges = 0, stat_splits = 0; uint64_t stat_start = stats_ticks()
+#define STATS_INC(name) (stat_##name++)
+#define STATS_END(op) do{ \
+        uint64_t stat_end = stats_ticks(); \
+        BogoStats *stat_local = stats_local(); \
+        if(stat_local) \
+            stats_record(&stat_local->op, stat_search, stat_merges, stat_splits, stat_end - stat_start); \
+    }while(0)
+#else
+#define STATS_BEGIN() ((void)0)
+#define STATS_INC(name) ((void)0)
+#define STATS_END(op) ((void)0)
+#endif
+
+// Build with -DBOGO_HUGEPAGE to back the heap and its metadata with transparent huge pages.
+// Both are then mapped 2 MiB aligned and advised with MADV_HUGEPAGE, falling back to a
+// plain mapping if the over-sized reservation fails. Blocks larger than SMALL_MAX are carved from
+// the end of a free chunk, so within a free chunk small blocks stay together at the front.
+#ifdef BOGO_HUGEPAGE
+#include <sys/mman.h>
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#ifndef SMALL_MAX
+#define SMALL_MAX 256
+#endif
+
+static unsigned char *heap = NULL;
+
+// Metadata arrays are pointers into the same mapping as the heap, see init_bogoalloc
+#define METADATA(type, name, count) static type *name
+
+static unsigned char *map_huge(size_t size){
+    size_t len = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    // Over-reserve by one huge page so we can trim to an aligned start
+    size_t reserved = len + HUGE_PAGE_SIZE;
+    unsigned char *base = mmap(NULL, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED){
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(base == MAP_FAILED){
+            fprintf(stderr, "Failed to map the heap!\n");
+            exit(1);
+        }
+        return base;
+    }
+
+    unsigned char *aligned = base + (HUGE_PAGE_SIZE - (uintptr_t)base % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+    if(base < aligned)
+        munmap(base, aligned - base);
+    if(aligned + len < base + reserved)
+        munmap(aligned + len, base + reserved - (aligned + len));
+
+#ifdef MADV_HUGEPAGE
+    // Best effort: with THP off the kernel just keeps normal pages
+    madvise(aligned, len, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+#else
+static _Alignas(ALIGNMENT) unsigned char heap[HEAPSIZE] = {0};
 
-static unsigned char heap[HEAPSIZE] = {0};
+#define METADATA(type, name, count) static type name[count]
+#endif
 
 typedef struct Chunk {
     unsigned char *head;
     size_t sz;
     size_t id;
-    struct Chunk *next;
+    struct Chunk *prev, *next;
 } Chunk;
 
-static Chunk chunk_list[CHUNK_NUM];
+METADATA(Chunk, chunk_list, CHUNK_NUM);
 
 static Chunk *alloc_chunks = NULL;
 static Chunk *free_chunks = NULL;
 static Chunk *unused_chunks = NULL;
 static size_t id_gen = 1;
+static int initialized = 0;
+
+// Bit i is set while an allocation starts at heap + i * ALIGNMENT.
+#define LIVE_MAP_SIZE ((HEAPSIZE / ALIGNMENT + 7) / 8)
+METADATA(uint8_t, live_map, LIVE_MAP_SIZE);
+
+static int live_index(const void *p, size_t *bit){
+    uintptr_t off = (uintptr_t)p - (uintptr_t)heap;
+    if(HEAPSIZE <= off || off % ALIGNMENT)
+        return 0;
+    *bit = off / ALIGNMENT;
+    return 1;
+}
+
+static int is_live(const void *p){
+    size_t bit;
+    return live_index(p, &bit) && (live_map[bit / 8] >> (bit % 8) & 1);
+}
+
+static void set_live(const void *p, int live){
+    size_t bit;
+    if(!live_index(p, &bit))
+        return;
+    if(live)
+        live_map[bit / 8] |= 1u << (bit % 8);
+    else
+        live_map[bit / 8] &= ~(1u << (bit % 8));
+}
+
+// Hash tables from an address to its chunk, so bogofree finds the chunk and its free neighbors
+// without walking a list. head_table holds every allocated or free chunk by its head, end_table
+// every free chunk by its end. An entry is the index into chunk_list plus 1, or 0 for an empty slot.
+// They have twice as many slots as there are chunks, so linear probing always finds a hole.
+#define TABLE_SIZE (2 * CHUNK_NUM)
+METADATA(uint32_t, head_table, TABLE_SIZE);
+METADATA(uint32_t, end_table, TABLE_SIZE);
+
+static unsigned char *table_key(const Chunk *chunk, int by_end){
+    return by_end ? chunk->head + chunk->sz : chunk->head;
+}
+
+// Neighboring blocks land in neighboring slots, which keeps a free and its merges in a few cache lines.
+static size_t table_slot(const unsigned char *addr){
+    return ((uintptr_t)addr - (uintptr_t)heap) / ALIGNMENT % TABLE_SIZE;
+}
+
+static Chunk *table_find(const uint32_t *table, int by_end, const unsigned char *addr){
+    for(size_t i = table_slot(addr); table[i]; i = (i + 1) % TABLE_SIZE){
+        Chunk *chunk = &chunk_list[table[i] - 1];
+        if(table_key(chunk, by_end) == addr)
+            return chunk;
+    }
+    return NULL;
+}
+
+static void table_insert(uint32_t *table, int by_end, const Chunk *chunk){
+    size_t i = table_slot(table_key(chunk, by_end));
+    while(table[i])
+        i = (i + 1) % TABLE_SIZE;
+    table[i] = (uint32_t)(chunk - chunk_list) + 1;
+}
+
+// The chunk's key must be the same as when it was inserted, so remove before moving head or sz.
+static void table_remove(uint32_t *table, int by_end, const Chunk *chunk){
+    uint32_t entry = (uint32_t)(chunk - chunk_list) + 1;
+    size_t i = table_slot(table_key(chunk, by_end));
+    while(table[i] != entry)
+        i = (i + 1) % TABLE_SIZE;
+    table[i] = 0;
+
+    // Move back the rest of the cluster so lookups do not stop at the new hole
+    for(size_t j = (i + 1) % TABLE_SIZE; table[j]; j = (j + 1) % TABLE_SIZE){
+        size_t home = table_slot(table_key(&chunk_list[table[j] - 1], by_end));
+        if(i <= j ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        table[i] = table[j];
+        table[j] = 0;
+        i = j;
+    }
+}
+
+// alloc_chunks and free_chunks are doubly linked so a chunk found by address unlinks in O(1).
+// unused_chunks only uses next.
+static void list_push(Chunk **list, Chunk *chunk){
+    chunk->prev = NULL;
+    chunk->next = *list;
+    if(*list)
+        (*list)->prev = chunk;
+    *list = chunk;
+}
+
+static void list_unlink(Chunk **list, Chunk *chunk){
+    if(chunk->prev)
+        chunk->prev->next = chunk->next;
+    else
+        *list = chunk->next;
+    if(chunk->next)
+        chunk->next->prev = chunk->prev;
+}
+
+static Chunk *fetch_unused(){
+    Chunk *chunk = unused_chunks;
+    unused_chunks = chunk->next;
+    return chunk;
+}
+
+static void release_unused(Chunk *chunk){
+    chunk->next = unused_chunks;
+    unused_chunks = chunk;
+}
+
+// Zero sized requests are rounded up too, so every block has a head of its own in live_map and head_table.
+static size_t round_size(size_t size){
+    return size ? (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT : ALIGNMENT;
+}
 
+// Only the first call sets up the heap, so C callers and the C++ resource can both call it.
 void init_bogoalloc(){
+    if(initialized)
+        return;
+    initialized = 1;
+
+#ifdef BOGO_HUGEPAGE
+    // Lay the metadata out after the heap, so chunk lookups touch the same huge pages.
+    // Everything but live_map is a multiple of 8 bytes, which keeps chunk_list aligned.
+    size_t heap_span = (HEAPSIZE + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    size_t chunks_size = CHUNK_NUM * sizeof(Chunk);
+    size_t table_bytes = TABLE_SIZE * sizeof(uint32_t);
+    heap = map_huge(heap_span + chunks_size + 2 * table_bytes + LIVE_MAP_SIZE);
+    chunk_list = (Chunk*)(heap + heap_span);
+    head_table = (uint32_t*)((unsigned char*)chunk_list + chunks_size);
+    end_table = (uint32_t*)((unsigned char*)head_table + table_bytes);
+    live_map = (uint8_t*)end_table + table_bytes;
+#endif
+
     for(size_t i = 0; i < CHUNK_NUM-1; i++){
         chunk_list[i].next = &chunk_list[i + 1];
     }
 
     unused_chunks = &chunk_list[0];
 
-    Chunk *free = unused_chunks;
-    unused_chunks = free->next;
+    Chunk *free = fetch_unused();
     free->head = heap;
     free->sz = HEAPSIZE;
     free->id = 0;
-    free->next = NULL;
-    free_chunks = free;
+    list_push(&free_chunks, free);
+    table_insert(head_table, 0, free);
+    table_insert(end_table, 1, free);
 
     // printf("unused %p free %p\n", )
 }
 
+// Whether unused_chunks has at least n entries left
+static int has_unused(size_t n){
+    const Chunk *chunk = unused_chunks;
+    for(; n && chunk; n--)
+        chunk = chunk->next;
+    return !n;
+}
+
+// Allocate from the free chunk, which must be large enough.
+// The block comes from the front of the chunk, or from its end if from_end is set.
+static void *take_chunk(Chunk *chunk, size_t size, size_t rounded_size, int from_end){
+    unsigned char *ret = from_end ? chunk->head + chunk->sz - rounded_size : chunk->head;
+    if(rounded_size == chunk->sz){
+        // The whole chunk becomes the block and keeps its head_table entry
+        table_remove(end_table, 1, chunk);
+        list_unlink(&free_chunks, chunk);
+        list_push(&alloc_chunks, chunk);
+    }
+    else{
+        // Splitting needs a spare entry from chunk_list
+        if(!unused_chunks)
+            return NULL;
+        if(from_end){
+            table_remove(end_table, 1, chunk);
+            chunk->sz -= rounded_size;
+            table_insert(end_table, 1, chunk);
+        }
+        else{
+            table_remove(head_table, 0, chunk);
+            chunk->head += rounded_size;
+            chunk->sz -= rounded_size;
+            table_insert(head_table, 0, chunk);
+        }
+
+        Chunk *new_chunk = fetch_unused();
+        new_chunk->head = ret;
+        new_chunk->sz = size;
+        new_chunk->id = id_gen++;
+        list_push(&alloc_chunks, new_chunk);
+        table_insert(head_table, 0, new_chunk);
+    }
+    set_live(ret, 1);
+    return ret;
+}
+
 void *bogoalloc(size_t size){
-    size_t rounded_size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    // Rounding up would wrap around
+    if(SIZE_MAX - ALIGNMENT < size)
+        return NULL;
+    size_t rounded_size = round_size(size);
 
+    STATS_BEGIN();
     void *ret = NULL;
-    Chunk **free_iter = &free_chunks;
-    while(*free_iter){
-        if(rounded_size <= (*free_iter)->sz){
-            ret = (*free_iter)->head;
-            if(rounded_size == (*free_iter)->sz){
-                Chunk *new_chunk = *free_iter;
-                *free_iter = (*free_iter)->next;
-                new_chunk->next = alloc_chunks;
-                alloc_chunks = new_chunk;
+    for(Chunk *chunk = free_chunks; chunk; chunk = chunk->next){
+        STATS_INC(search);
+        if(rounded_size <= chunk->sz){
+            if(rounded_size != chunk->sz){
+                // Splitting needs a spare entry from chunk_list
+                if(!unused_chunks)
+                    break;
+                STATS_INC(splits);
             }
-            else{
-                (*free_iter)->head += rounded_size;
-                (*free_iter)->sz -= rounded_size;
-
-                Chunk *next_alloc = alloc_chunks;
-                alloc_chunks = unused_chunks;
-                unused_chunks = unused_chunks->next;
-                alloc_chunks->head = ret;
-                alloc_chunks->sz = size;
-                alloc_chunks->id = id_gen++;
-                alloc_chunks->next = next_alloc;
+#ifdef BOGO_HUGEPAGE
+            ret = take_chunk(chunk, size, rounded_size, SMALL_MAX < rounded_size);
+#else
+            ret = take_chunk(chunk, size, rounded_size, 0);
+#endif
+            break;
+        }
+    }
+
+    STATS_END(alloc);
+    return ret;
+}
+
+// Like bogoalloc, but the returned address is a multiple of alignment, which must be a power of 2.
+// The padding in front of the block stays in the free list as a chunk of its own,
+// so bogofree merges it back when the block is released.
+void *bogoalloc_aligned(size_t size, size_t alignment){
+    // Rounding up and padding would wrap around
+    if(SIZE_MAX - alignment < size)
+        return NULL;
+    if(alignment <= ALIGNMENT)
+        return bogoalloc(size);
+
+    size_t rounded_size = round_size(size);
+
+    STATS_BEGIN();
+    void *ret = NULL;
+    for(Chunk *chunk = free_chunks; chunk; chunk = chunk->next){
+        STATS_INC(search);
+        size_t pad = (alignment - (uintptr_t)chunk->head % alignment) % alignment;
+        if(pad + rounded_size <= chunk->sz){
+            // Check for every entry we need up front; a padding chunk split off without the block
+            // would sit next to the remainder as two free chunks that are never merged again
+            if(!has_unused((pad != 0) + (pad + rounded_size != chunk->sz)))
+                break;
+            if(pad){
+                STATS_INC(splits);
+                Chunk *gap = fetch_unused();
+                gap->head = chunk->head;
+                gap->sz = pad;
+                gap->id = id_gen++;
+                table_remove(head_table, 0, chunk);
+                chunk->head += pad;
+                chunk->sz -= pad;
+                table_insert(head_table, 0, chunk);
+                list_push(&free_chunks, gap);
+                table_insert(head_table, 0, gap);
+                table_insert(end_table, 1, gap);
             }
+            if(rounded_size != chunk->sz)
+                STATS_INC(splits);
+            // The aligned head is at the front, so never carve from the end here
+            ret = take_chunk(chunk, size, rounded_size, 0);
             break;
         }
-        free_iter = &(*free_iter)->next;
     }
 
+    STATS_END(alloc);
     return ret;
 }
 
 #define BOGOFREE_DEBUG
 
+// Free the block at p. rounded_size is its size rounded up, or 0 to take it from the chunk.
+static void free_block(void *p, size_t rounded_size){
+    STATS_BEGIN();
+    Chunk *freeing_chunk = is_live(p) ? table_find(head_table, 0, p) : NULL;
+    if(!freeing_chunk){
+        BOGOFREE_DEBUG("WARNING! couldn't find ptr in bogofree %p\n", p);
+        STATS_END(free);
+        return;
+    }
+    set_live(p, 0);
+    list_unlink(&alloc_chunks, freeing_chunk);
+    list_push(&free_chunks, freeing_chunk);
+    freeing_chunk->sz = rounded_size ? rounded_size : round_size(freeing_chunk->sz); // Round up for free chunks
+
+    BOGOFREE_DEBUG("[%lu] Start searching neighbor free chunks (%lu, %lu)\n", freeing_chunk->id, freeing_chunk->head - heap, freeing_chunk->head + freeing_chunk->sz - heap);
+
+    // A chunk that starts at our end and is not live is the free neighbor after us
+    int merged = 0;
+    unsigned char *end = freeing_chunk->head + freeing_chunk->sz;
+    Chunk *next = is_live(end) ? NULL : table_find(head_table, 0, end);
+    if(next){
+        BOGOFREE_DEBUG("[%lu] Merging %lu next (%ld, %ld)\n", freeing_chunk->id, next->id, (intptr_t)(next->head - heap), (intptr_t)(freeing_chunk->head - heap));
+        table_remove(head_table, 0, next);
+        table_remove(end_table, 1, next);
+        list_unlink(&free_chunks, next);
+        freeing_chunk->sz += next->sz;
+        release_unused(next);
+        merged = 1;
+        STATS_INC(merges);
+    }
+    Chunk *prev = table_find(end_table, 1, freeing_chunk->head);
+    if(prev){
+        BOGOFREE_DEBUG("[%lu] Merging %lu prev (%ld, %ld)\n", freeing_chunk->id, prev->id, (intptr_t)(prev->head - heap), (intptr_t)(freeing_chunk->head - heap));
+        table_remove(end_table, 1, prev);
+        table_remove(head_table, 0, freeing_chunk);
+        list_unlink(&free_chunks, freeing_chunk);
+        prev->sz += freeing_chunk->sz;
+        table_insert(end_table, 1, prev);
+        release_unused(freeing_chunk);
+        merged = 1;
+        STATS_INC(merges);
+    }
+    else
+        table_insert(end_table, 1, freeing_chunk);
+    if(!merged)
+        BOGOFREE_DEBUG("[%lu] Moving chunk to free list\n", freeing_chunk->id);
+    STATS_END(free);
+}
+
 void bogofree(void *p){
-    Chunk **alloc_iter = &alloc_chunks;
-    while(*alloc_iter){
-        if((*alloc_iter)->head == p){
-            Chunk *freeing_chunk = *alloc_iter;
-            *alloc_iter = freeing_chunk->next;
-
-            freeing_chunk->next = free_chunks;
-            free_chunks = freeing_chunk;
-            size_t *sz = &freeing_chunk->sz;
-            *sz = (*sz + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT; // Round up for free chunks
-
-            BOGOFREE_DEBUG("[%lu] Start searching neighbor free chunks (%lu, %lu)\n", freeing_chunk->id, freeing_chunk->head - heap, freeing_chunk->head + freeing_chunk->sz - heap);
-
-            Chunk **neighbor_iter = &free_chunks;
-            int merged = 0;
-            while(*neighbor_iter){
-                // size_t next_sz = ((*neighbor_iter)->sz + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
-                BOGOFREE_DEBUG("   Examining chunk %lu (%lu, %lu)\n", (*neighbor_iter)->id, (*neighbor_iter)->head - heap, (*neighbor_iter)->head + (*neighbor_iter)->sz - heap);
-                if(*neighbor_iter != freeing_chunk && (*neighbor_iter)->head == freeing_chunk->head + freeing_chunk->sz){
-                    BOGOFREE_DEBUG("[%lu] Merging %lu next (%ld, %ld)\n", freeing_chunk->id, (*neighbor_iter)->id, (intptr_t)((*neighbor_iter)->head - heap), (intptr_t)(freeing_chunk->head - heap));
-                    freeing_chunk->sz += (*neighbor_iter)->sz;
-                    Chunk *unused_next = unused_chunks;
-                    unused_chunks = *neighbor_iter;
-                    *neighbor_iter = (*neighbor_iter)->next;
-                    unused_chunks->next = unused_next;
-                    merged = 1;
-                    break;
-                }
-                neighbor_iter = &(*neighbor_iter)->next;
-            }
-            neighbor_iter = &free_chunks;
-            while(*neighbor_iter){
-                if(*neighbor_iter != freeing_chunk && (*neighbor_iter)->head + (*neighbor_iter)->sz == freeing_chunk->head){
-                    BOGOFREE_DEBUG("[%lu] Merging %lu prev (%ld, %ld)\n", freeing_chunk->id, (*neighbor_iter)->id, (intptr_t)((*neighbor_iter)->head - heap), (intptr_t)(freeing_chunk->head - heap));
-                    (*neighbor_iter)->sz += freeing_chunk->sz;
-                    Chunk *unused_next = unused_chunks;
-                    unused_chunks = freeing_chunk;
-                    free_chunks = freeing_chunk->next;
-                    unused_chunks->next = unused_next;
-                    merged = 1;
-                    break;
-                }
-                neighbor_iter = &(*neighbor_iter)->next;
-            }
-            if(!merged)
-                BOGOFREE_DEBUG("[%lu] Moving chunk to free list\n", freeing_chunk->id);
-            return;
-        }
-        alloc_iter = &(*alloc_iter)->next;
+    free_block(p, 0);
+}
+
+// Free a block whose requested size is known. The size gives the block's end, and so the free
+// neighbor after it, without reading the chunk; it must match the allocation. Build with
+// -DBOGOFREE_SIZED_CHECK to report mismatching sizes and free by the chunk's own size instead.
+void bogofree_sized(void *p, size_t size){
+#ifdef BOGOFREE_SIZED_CHECK
+    const Chunk *chunk = is_live(p) ? table_find(head_table, 0, p) : NULL;
+    if(chunk && round_size(chunk->sz) != round_size(size)){
+        fprintf(stderr, "WARNING! bogofree_sized got size %lu for %p of size %lu\n", size, p, chunk->sz);
+        free_block(p, 0);
+        return;
     }
-    BOGOFREE_DEBUG("WARNING! couldn't find ptr in bogofree %p\n", p);
+#endif
+    free_block(p, round_size(size));
 }
 
 // There is no trivial way to dump all lists without iterating each linked list
@@ -212,10 +630,10 @@ void dump_heap(){
     }
 }
 
+#ifndef BOGOALLOC_NO_MAIN
 int main(){
-    printf("heap head = %p\n", heap);
-
     init_bogoalloc();
+    printf("heap head = %p\n", heap);
     printf("Unused chunks: %lu\n", count_chunks(unused_chunks));
 
     double *ptrs[15] = {NULL};
@@ -266,4 +684,11 @@ int main(){
 
     printf("sizeof size_t: %lu\n", sizeof(size_t));
     printf("sizeof Chunk: %lu\n", sizeof(Chunk));
-}
\ No newline at end of file
+
+#ifdef BOGO_STATS
+    BogoStats stats;
+    bogo_stats_aggregate(&stats);
+    bogo_stats_print(&stats);
+#endif
+}
+#endif